@@ -22,6 +22,39 @@ bool file_exists(const std::string& fileName) {
 	return file.good();
 }
 
+/**
+ * Checks if the file with the passed name exists and can be read,
+ * without creating the file if it does not exist.
+ *
+ * @param fileName : name of the file
+ *
+ * @return bool indicating whether the file can be read
+ */
+bool file_readable(const std::string& fileName) {
+	std::ifstream file(fileName.c_str());
+	return file.good();
+}
+
+/**
+ * Computes a 64-bit FNV-1a hash of the contents of the file with the passed name.
+ *
+ * @param fileName : name of the file
+ *
+ * @return hash of the file contents
+ */
+uint64_t file_hash(const std::string& fileName) {
+	std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+	uint64_t hash = 14695981039346656037ULL;
+	char buffer[4096];
+	while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+		for (std::streamsize i = 0; i < file.gcount(); i++) {
+			hash ^= static_cast<unsigned char>(buffer[i]);
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
 /**
  * Removes the file extension from the passed file name
  * and returns the raw file name.
@@ -8,8 +8,15 @@
 #ifndef SRC_FILEUTILITY_HPP_
 #define SRC_FILEUTILITY_HPP_
 
+#include <string>
+#include <stdint.h>
+
 bool file_exists(const std::string& fileName);
 
+bool file_readable(const std::string& fileName);
+
+uint64_t file_hash(const std::string& fileName);
+
 std::string remove_extension(const std::string fullFileName);
 
 std::string trimFilePathToName(const std::string path);
@@ -6,11 +6,17 @@
  */
 
 #include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cfloat>
+#include <unistd.h>
 
 #include "DecPOMDPDiscrete.h"
 #include "Timing.h"
 #include "NullPlanner.h"
+#include "PlanningUnitMADPDiscreteParameters.h"
 #include "directories.h"
+#include "E.h"
 
 #include "MDPValueIteration.h"
 
@@ -29,18 +35,53 @@ static char doc[] =
 \vFor more information please consult the MADP documentation. \
 ";
 
+// Q-tables cache options of the MDP-solver
+const int OPT_QCACHE = 5001;
+const int OPT_REQUIREQCACHE = 5002;
+static struct argp_option qcacheOptions[] = {
+		{ "Qcache", OPT_QCACHE, 0, 0,
+				"Store the Q-tables found by value iteration in the results folder, and reuse them in \
+subsequent runs on the same problem, discount and horizon" },
+		{ "requireQcache", OPT_REQUIREQCACHE, 0, 0,
+				"Like --Qcache, but fail instead of running value iteration if no cached Q-tables exist" },
+		{ 0 } };
+
+/**
+ * Parses the Q-tables cache options.
+ */
+static error_t qcacheParseArgument(int key, char *arg, struct argp_state *state) {
+	ArgumentHandlers::Arguments* theArgumentsStruc = (ArgumentHandlers::Arguments*) state->input;
+	switch (key) {
+	case OPT_QCACHE:
+		theArgumentsStruc->useQcache = 1;
+		break;
+	case OPT_REQUIREQCACHE:
+		theArgumentsStruc->useQcache = 1;
+		theArgumentsStruc->requireQcache = true;
+		break;
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+static const struct argp qcacheArgp = { qcacheOptions, qcacheParseArgument, 0, 0 };
+static const struct argp_child qcache_child = { &qcacheArgp, 0, "Q-tables cache options:", 0 };
+
 //NOTE: make sure that the below value (nrChildParsers) is correct!
-const int nrChildParsers = 6;
+const int nrChildParsers = 7;
 const struct argp_child childVector[] = { ArgumentHandlers::problemFile_child,
 		ArgumentHandlers::globalOptions_child,
 		ArgumentHandlers::outputFileOptions_child,
 		ArgumentHandlers::modelOptions_child,
 		ArgumentHandlers::solutionMethodOptions_child,
+		qcache_child,
 		ArgumentHandlers::simulation_child, { 0 } };
 #include "argumentHandlersPostChild.h"
 
 static std::string prismFileName;
 static std::string timingsFileName;
+static std::string qCacheFileName;
 
 /**
  * Instantiates a problem based on the passed arguments.
@@ -56,6 +97,32 @@ static DecPOMDPDiscreteInterface* instantiateProblem(ArgumentHandlers::Arguments
 	return mdp;
 }
 
+/**
+ * Retrieves the full path of the Q-tables cache file for the loaded problem, discount and horizon.
+ *
+ * The file is stored in the results folder and its name contains the full name of the loaded
+ * problem file, the discount at full precision, the horizon and a hash of the problem file.
+ *
+ * @param args : Arguments
+ *
+ * @return full file path of the Q-tables cache file, or an empty string if it cannot be determined
+ */
+static std::string getQCacheFilePath(const ArgumentHandlers::Arguments& args) {
+	std::string problemFilePath;
+	try {
+		problemFilePath = directories::MADPGetProblemFilename(args);
+	} catch (E& e) {
+		return "";
+	}
+	if (!file_readable(problemFilePath))
+		return "";
+	std::stringstream ss;
+	ss << createResultsFolder(args.dpf) << trimFilePathToName(problemFilePath)
+			<< "_d" << std::setprecision(17) << args.discount << "_h" << args.horizon
+			<< "_" << std::hex << file_hash(problemFilePath) << "_QTables";
+	return ss.str();
+}
+
 /**
  * Sets up the output files of the MDP-solver program.
  *
@@ -72,6 +139,47 @@ static void setupOutputFiles(ArgumentHandlers::Arguments& args) {
 			args.dryrun = true;
 		}
 	}
+	if (args.useQcache) {
+		if (args.dryrun) {
+			std::cout << "Warning: dry run, the Q-tables cache is not used";
+			if (args.requireQcache)
+				std::cout << " (--requireQcache is ignored)";
+			std::cout << std::endl;
+		}
+		else {
+			qCacheFileName = getQCacheFilePath(args);
+			if (qCacheFileName.empty()) {
+				if (args.requireQcache)
+					throw E("MDP-solver: cannot determine the Q-tables cache file of the problem");
+				std::cout << "Warning: cannot determine the Q-tables cache file of the problem, "
+						<< "the Q-tables cache is not used" << std::endl;
+			}
+			else if (args.requireQcache && !file_readable(qCacheFileName))
+				throw E("MDP-solver: required Q-tables cache " + qCacheFileName + " does not exist");
+		}
+	}
+}
+
+/**
+ * Retrieves the action with the highest Q-value for a state (the first one in case of ties).
+ *
+ * @param Q : The Q-table containing the Q-values of all state-action pairs
+ * @param state_no : The state for which to find the maximizing action
+ *
+ * @return Index of the maximizing action
+ */
+static Index getMaximizingAction(const QTable& Q, Index state_no) {
+	size_t nrActions = Q.GetNrActions();
+	Index maximizingActionIndex = 0;
+	double maxQ = -DBL_MAX;
+	for (Index action_no = 0; action_no < nrActions; action_no++) {
+		double q = Q(state_no, action_no);
+		if (q > maxQ) {
+			maxQ = q;
+			maximizingActionIndex = action_no;
+		}
+	}
+	return maximizingActionIndex;
 }
 
 /**
@@ -85,8 +193,11 @@ static void setupOutputFiles(ArgumentHandlers::Arguments& args) {
 PolicyVector getOptimalPolicy(DecPOMDPDiscreteInterface* mdp, MDPValueIteration& vi) {
 	std::cout << "Optimal policy:" << std::endl;
 	std::vector<Index> vector;
-	for (int state_no = 0; state_no < mdp->GetNrStates(); state_no++) {
-		Index maximizingActionIndex = vi.GetMaximizingAction(0, state_no);
+	size_t nrStates = mdp->GetNrStates();
+	vector.reserve(nrStates);
+	QTable Q = vi.GetQTable(0);
+	for (Index state_no = 0; state_no < nrStates; state_no++) {
+		Index maximizingActionIndex = getMaximizingAction(Q, state_no);
 		std::cout << "State no.: " << state_no << " Maximizing action: " << maximizingActionIndex << std::endl;
 		vector.push_back(maximizingActionIndex);
 	}
@@ -94,6 +205,29 @@ PolicyVector getOptimalPolicy(DecPOMDPDiscreteInterface* mdp, MDPValueIteration&
 	return p;
 }
 
+/**
+ * Runs value iteration and stores the resulting Q-tables in the cache file.
+ *
+ * The Q-tables are first saved to a temporary file that is unique for this
+ * process, and only then renamed to the cache file. Since the rename is atomic, parallel
+ * runs on the same problem never read a partially written cache file. A temporary file
+ * left behind by an earlier, killed process with the same process id is removed first,
+ * as PlanWithCache would otherwise load it instead of planning.
+ *
+ * @param vi : The value iteration to plan with
+ * @param cacheFileName : The name of the Q-tables cache file
+ */
+static void planWithQcache(MDPValueIteration& vi, const std::string& cacheFileName) {
+	std::stringstream tmpFileName;
+	tmpFileName << cacheFileName << ".tmp" << getpid();
+	remove(tmpFileName.str().c_str());
+	vi.PlanWithCache(tmpFileName.str(), true);
+	if (rename(tmpFileName.str().c_str(), cacheFileName.c_str()) != 0) {
+		std::cout << "VI: could not store Q-tables cache " << cacheFileName << std::endl;
+		remove(tmpFileName.str().c_str());
+	}
+}
+
 /**
  * Applies value iteration for the MDP problem.
  *
@@ -102,23 +236,38 @@ PolicyVector getOptimalPolicy(DecPOMDPDiscreteInterface* mdp, MDPValueIteration&
  * @return PolicyVector corresponding to the optimal policy
  */
 static PolicyVector applyValueIteration(ArgumentHandlers::Arguments& args, DecPOMDPDiscreteInterface* mdp) {
+	// Value iteration only needs the model itself, so do not let the planning unit
+	// generate (and store) the action-observation histories and joint beliefs
+	PlanningUnitMADPDiscreteParameters params;
+	params.SetComputeAll(false);
+	params.SetComputeJointBeliefs(false);
+
 	// Apply Value Iteration
-	PlanningUnitDecPOMDPDiscrete *np = new NullPlanner(args.horizon, mdp);
-	MDPValueIteration vi(*np);
-	std::cout << "Running value iteration..." << std::endl;
+	NullPlanner np(params, args.horizon, mdp);
+	MDPValueIteration vi(np);
 	Timing time;
-	time.Start("Plan");
-	vi.Plan();
-	time.Stop("Plan");
+	if (!qCacheFileName.empty() && file_readable(qCacheFileName)) {
+		std::cout << "Loading cached Q-tables from " << qCacheFileName << "..." << std::endl;
+		time.Start("LoadQcache");
+		vi.PlanWithCache(qCacheFileName, false);
+		time.Stop("LoadQcache");
+	}
+	else {
+		std::cout << "Running value iteration..." << std::endl;
+		time.Start("Plan");
+		if (!qCacheFileName.empty())
+			planWithQcache(vi, qCacheFileName);
+		else
+			vi.Plan();
+		time.Stop("Plan");
+	}
 	std::cout << "...done." << std::endl;
 
 	// Write VI timing information to file
 	if (!args.dryrun)
 		time.Save(timingsFileName);
 
-	PolicyVector policy = getOptimalPolicy(mdp, vi);
-	delete np;
-	return policy;
+	return getOptimalPolicy(mdp, vi);
 }
 
 /**
@@ -138,6 +287,7 @@ int main(int argc, char **argv) {
 
 	} catch (E& e) {
 		e.Print();
+		return (1);
 	}
 
 	return (0);
@@ -7,13 +7,13 @@
 
 #include "PolicyVector.hpp"
 
-PolicyVector::PolicyVector(std::vector<Index> vect) {
-	policyVector = vect;
+PolicyVector::PolicyVector(const std::vector<Index>& vect) :
+		policyVector(vect) {
 }
 
 PolicyVector::~PolicyVector() {
 }
 
-Index PolicyVector::get(Index state_no) {
+Index PolicyVector::get(Index state_no) const {
 	return policyVector[state_no];
 }
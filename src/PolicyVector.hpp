@@ -15,9 +15,9 @@ class PolicyVector {
 private:
 	std::vector<Index> policyVector;
 public:
-	PolicyVector(std::vector<Index>);
+	PolicyVector(const std::vector<Index>&);
 	virtual ~PolicyVector();
-	Index get(Index state_no);
+	Index get(Index state_no) const;
 };
 
 #endif /* SRC_POLICYVECTOR_HPP_ */
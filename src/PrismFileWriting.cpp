@@ -6,37 +6,91 @@
  */
 
 #include <fstream>
+#include <boost/numeric/ublas/matrix_proxy.hpp>
 #include "PrismFileWriting.hpp"
 #include "FileUtility.hpp"
+#include "TransitionModelMappingSparse.h"
+#include "E.h"
 
+#include <cstdio>
 #include <sys/types.h>
 #include <sys/stat.h>
 
 /**
- * Retrieves a line for a transition from a certain state to all possible successor states
- * and the probability ending up in that state.
+ * Retrieves the sparse transition model of the passed MDP, if it stores its transitions
+ * sparsely (i.e., when the problem was loaded with the --sparse option).
  *
+ * @param mdp : The MDP model
+ *
+ * @return The sparse transition model, or 0 if the transitions are not stored sparsely
+ */
+static const TransitionModelMappingSparse* getSparseTransitionModel(DecPOMDPDiscreteInterface* mdp) {
+	return dynamic_cast<const TransitionModelMappingSparse*>(mdp->GetTransitionModelDiscretePtr());
+}
+
+/**
+ * Writes a single successor state term of a transition line.
+ *
+ * @param out : The stream to write the term to
+ * @param prob : The probability of ending up in the successor state
+ * @param state_suc_no : The identifying number of the successor state
+ * @param isFirst : Whether this is the first term of the line, reset to false afterwards
+ */
+static void writeSuccessorTerm(std::ostream& out, double prob, Index state_suc_no, bool& isFirst) {
+	if (!isFirst) {
+		out << " + ";
+	}
+	out << static_cast<float>(prob) << ":(state' = " << state_suc_no << ")";
+	isFirst = false;
+}
+
+/**
+ * Writes a line for a transition from a certain state to all successor states that can
+ * be reached from it, and the probability ending up in that state.
+ *
+ * Successor states with zero probability are left out. For sparse transition models only
+ * the stored (non-zero) entries of the row of the transition matrix are visited, otherwise
+ * the model is queried for each of the successor states.
+ *
+ * Throws an E if no successor state can be reached, as PRISM does not accept an empty
+ * transition line.
+ *
+ * @param out : The stream to write the line to
  * @param state_no : The identifying number of the source state
  * @param mdp : The MDP defining the total number of states
+ * @param sparseModel : The sparse transition model of the MDP, or 0 if not available
  * @param policy : The policy defining which action to take from this state
- *
- * @return Line for PRISM mdp input file defining probabilities of getting from a state to each other state with the action define by the passed policy.
  */
-static std::string getTransitionLine(int state_no, DecPOMDPDiscreteInterface* mdp, PolicyVector policy) {
+static void writeTransitionLine(std::ostream& out, Index state_no, DecPOMDPDiscreteInterface* mdp,
+		const TransitionModelMappingSparse* sparseModel, const PolicyVector& policy) {
 	Index maximizing_action_no = policy.get(state_no);
-	std::stringstream ss;
-	ss << "[] state = " << state_no << " -> ";
-	for (int state_suc_no = 0; state_suc_no < mdp->GetNrStates(); state_suc_no++) {
-		float prob = mdp->GetTransitionProbability(state_no, maximizing_action_no, state_suc_no);
-		ss << prob << ":(state' = " << state_suc_no << ")";
-		if (state_suc_no == mdp->GetNrStates() - 1) {
-			ss << ";" << std::endl;
+	out << "[] state = " << state_no << " -> ";
+	bool isFirst = true;
+	if (sparseModel != 0) {
+		typedef boost::numeric::ublas::matrix_row<const TransitionModelMappingSparse::SparseMatrix> SparseRow;
+		SparseRow row(*sparseModel->GetMatrixPtr(maximizing_action_no), state_no);
+		for (SparseRow::const_iterator it = row.begin(); it != row.end(); ++it) {
+			if (*it > 0) {
+				writeSuccessorTerm(out, *it, it.index(), isFirst);
+			}
 		}
-		else {
-			ss << " + ";
+	}
+	else {
+		size_t nrStates = mdp->GetNrStates();
+		for (Index state_suc_no = 0; state_suc_no < nrStates; state_suc_no++) {
+			double prob = mdp->GetTransitionProbability(state_no, maximizing_action_no, state_suc_no);
+			if (prob > 0) {
+				writeSuccessorTerm(out, prob, state_suc_no, isFirst);
+			}
 		}
 	}
-	return ss.str();
+	if (isFirst) {
+		std::stringstream ss;
+		ss << "writePrismFile: state " << state_no << " has no successor state with non-zero probability under action "
+				<< maximizing_action_no;
+		throw E(ss.str());
+	}
+	out << ";\n";
 }
 
 /**
@@ -50,8 +104,9 @@ static std::string getInitialStatesLine(DecPOMDPDiscreteInterface* mdp) {
 	std::stringstream ss;
 	ss << "init ";
 	bool isFirst = true;
-	for (int state_no = 0; state_no < mdp->GetNrStates(); state_no++) {
-		if (mdp->GetInitialStateProbability(state_no) > 0) {
+	std::vector<double> initialStateProbabilities = mdp->GetISD()->ToVectorOfDoubles();
+	for (size_t state_no = 0; state_no < initialStateProbabilities.size(); state_no++) {
+		if (initialStateProbabilities[state_no] > 0) {
 			if (!isFirst) {
 				ss << " | ";
 			}
@@ -59,10 +114,22 @@ static std::string getInitialStatesLine(DecPOMDPDiscreteInterface* mdp) {
 			isFirst = false;
 		}
 	}
-	ss << " endinit" << std::endl;
+	ss << " endinit\n";
 	return ss.str();
 }
 
+/**
+ * Removes the file at the passed path, if it is a regular file (so not e.g. /dev/null).
+ *
+ * @param filePath : The path of the file to remove
+ */
+static void removeRegularFile(const std::string& filePath) {
+	struct stat fileStat;
+	if (stat(filePath.c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode)) {
+		remove(filePath.c_str());
+	}
+}
+
 /**
  * Writes to the file specified by filePath contents of a PRISM input file based on the passed
  * MDP definition and the provided policy corresponding to this mdp model.
@@ -83,27 +150,38 @@ static std::string getInitialStatesLine(DecPOMDPDiscreteInterface* mdp) {
  *  [] ....
  *  [] state = STATE_N -> PROB_1:(state' = ENDSTATE_1) + ... + PROB_N:(state' = ENDSTATE_N);
  *
+ *  where only the successor states ENDSTATE_i with a non-zero probability PROB_i are listed
+ *
  *  endmodule
  *
  *  init STATE_i=PROB_i | STATE_j=PROB_j | ... endinit
  *
  */
-void writePrismFile(std::string filePath, DecPOMDPDiscreteInterface* mdp, PolicyVector policy) {
+void writePrismFile(std::string filePath, DecPOMDPDiscreteInterface* mdp, const PolicyVector& policy) {
 	std::ofstream prismFile;
 	prismFile.open(filePath.c_str());
 
 	// Define that the model is a Markov Decision Process
-	prismFile << "mdp" << std::endl << std::endl;
+	prismFile << "mdp\n\n";
 	// Set the module name to the file name
-	prismFile << "module " << remove_extension(trimFilePathToName(filePath)) << std::endl << std::endl;
+	prismFile << "module " << remove_extension(trimFilePathToName(filePath)) << "\n\n";
 	// Define the (number of) states
-	prismFile << "state:[0.." << (mdp->GetNrStates() - 1) << "];" << std::endl << std::endl;
+	size_t nrStates = mdp->GetNrStates();
+	prismFile << "state:[0.." << (nrStates - 1) << "];\n\n";
 	// Define the transition for each state and probabilities of ending up in other states for that transition
-	for (int state_no = 0; state_no < mdp->GetNrStates(); state_no++) {
-		prismFile << getTransitionLine(state_no, mdp, policy);
+	const TransitionModelMappingSparse* sparseModel = getSparseTransitionModel(mdp);
+	try {
+		for (Index state_no = 0; state_no < nrStates; state_no++) {
+			writeTransitionLine(prismFile, state_no, mdp, sparseModel, policy);
+		}
+	} catch (E& e) {
+		// Do not leave a partially written (and therefore invalid) PRISM file behind
+		prismFile.close();
+		removeRegularFile(filePath);
+		throw;
 	}
-	prismFile << std::endl;
-	prismFile << "endmodule" << std::endl << std::endl;
+	prismFile << "\n";
+	prismFile << "endmodule\n\n";
 
 	// Define the initial/starting states of the model
 	prismFile << getInitialStatesLine(mdp);
@@ -118,7 +196,7 @@ void writePrismFile(std::string filePath, DecPOMDPDiscreteInterface* mdp, Policy
  *
  * @return The results folder path
  */
-static std::string createResultsFolder(std::string problemFilePath) {
+std::string createResultsFolder(std::string problemFilePath) {
 	std::size_t problemDirPathIndex = problemFilePath.find_last_of("\\/");
 	std::string problemDirPath = problemFilePath.substr(0, problemDirPathIndex);
 	mkdir((problemDirPath + "/results/").c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
@@ -152,3 +230,4 @@ std::string getPrismFilePath(std::string problemFilePath, double discount, doubl
 	ss << getResultsFilePath(problemFilePath) << "_d" << fractional_part_as_int(discount, 2) << "_h" << horizon << ".nm";
 	return ss.str();
 }
+
@@ -11,8 +11,10 @@
 #include "DecPOMDPDiscrete.h"
 #include "PolicyVector.hpp"
 
-void writePrismFile(std::string filePath, DecPOMDPDiscreteInterface* mdp, PolicyVector policy);
+void writePrismFile(std::string filePath, DecPOMDPDiscreteInterface* mdp, const PolicyVector& policy);
 
 std::string getPrismFilePath(std::string problemFilePath, double discount, double horizon);
 
+std::string createResultsFolder(std::string problemFilePath);
+
 #endif /* SRC_PRISMFILEWRITING_HPP_ */